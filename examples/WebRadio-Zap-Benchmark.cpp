@@ -0,0 +1,79 @@
+// Zapping benchmark: switch stations on a mock ICYcast server (tools/mock_icy_server.py)
+// and dump one trace per switch; report with tools/zap_bench.py (see README)
+
+#include <Arduino.h>
+#include "SimpleWebRadio.h"
+#include "SimpleTrace.h"
+#include "SimpleUtils.h"
+#include "SimplePrint.h"
+
+#ifndef SIMPLE_WEBRADIO_TRACE
+#error "enable SIMPLE_WEBRADIO_TRACE in SimpleTrace.h"
+#endif
+
+#define ZAP_COUNT      100                                  // number of station switches
+#define ZAP_MEASURE   3000                                  // msec to wait for first audio
+#define ZAP_DWELL     2000                                  // msec to play before next switch
+
+byte macaddr[] = { 0xDE, 0xAD, 0xBE, 0xEF, 0xFE, 0xED };    // mac address
+byte iplocal[] = { 192, 168,   1,  62 };                    // lan ip (e.g. "192.168.1.178")
+byte gateway[] = { 192, 168,   1,   1 };                    // router gateway
+byte subnet[]  = { 255, 255, 255,   0 };                    // subnet mask
+byte DNS[]     = { 192, 168,   1,  10 };                    // DNS server (benchmark pc, mock_icy_server.py --dns)
+
+PresetInfo presetList[] = {                                 // mock server stations (host = benchmark pc)
+  { "/station1",              { 192, 168,   1,  10}, 8000 },
+  { "mock-icy.lan/station2",  {   0,   0,   0,   0}, 8000 },
+};                                                          // IP preset (no lookup) + host name preset
+
+SimpleRadio radio;                                          // radio object (to play ICYcast streams)
+int         zaps = 0;                                       // station switches done
+
+void playFor( unsigned long msec);                          // feed player for msec
+
+void setup()
+{
+  BEGIN( 115200);                                           // fast Serial keeps dumps short
+
+  Ethernet.begin( macaddr, iplocal, DNS, gateway, subnet);  // start ethernet
+
+  radio.setPlayer( 2, 6, 7, 8);                             // initialize MP3 player
+  radio.setVolume( 70);                                     // set volume of player
+
+  traceSkip( TRACE_READ);                                   // record phase events only
+  traceSkip( TRACE_PLAY);                                   // (keeps slow switches in the ring)
+}
+
+void loop()
+{
+  if ( zaps >= ZAP_COUNT) return;                           // benchmark done
+
+  byte preset = zaps % ( sizeof( presetList) / sizeof( PresetInfo));
+
+  traceClear( true);                                        // keep first events of this switch
+  TRACE( TRACE_ZAP, zaps, preset);                          // switch starts (= rotary turned)
+
+  radio.stopICYcastStream();                                // same sequence as hndlDevice + hndlPlayer
+  radio.openICYcastStream( &presetList[ preset]);           // open new ICYcast stream
+  radio.readICYcastStream();                                // receive next stream data
+  radio.hndlICYcastHeader();                                // process next stream data
+
+  playFor( ZAP_MEASURE);                                    // wait for first audio
+  traceDump( Serial);                                       // one dump per switch
+
+  playFor( ZAP_DWELL);                                      // keep playing before next switch
+  zaps++;
+}
+
+// feed player for msec
+void playFor( unsigned long msec)
+{
+  unsigned long start = millis();
+
+  while ( millis() - start < msec) {
+    if ( radio.connected()) {                               // if iCYcast stream active
+      radio.readICYcastStream();                            // receive next stream data
+      radio.hndlICYcastStream();                            // process next stream data
+    }
+  }
+}
@@ -3,6 +3,7 @@
 #include <Wire.h>
 #include "LiquidCrystal_I2C.h"
 #include "SimpleWebRadio.h"
+#include "SimpleTrace.h"
 #include "SimpleControl.h"
 
 #include "SimpleUtils.h"
@@ -100,6 +101,10 @@ void loop()
 
   save.check();                                              // check if EEPROM needs update
   disp.check();                                              // check if screen needs update
+
+  #ifdef DEBUG_MODE
+  if ( Serial.read() == 't') traceDump( Serial);             // dump trace ring on request ('t')
+  #endif
 }
 
 void hndlPlayer()
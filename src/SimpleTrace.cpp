@@ -0,0 +1,110 @@
+// Copyright  : Dennis Buis (2017)
+// License    : MIT
+// Platform   : Arduino
+// Library    : Simple WebRadio Library for Arduino
+// File       : SimpleTrace.cpp
+// Purpose    : low-overhead binary trace ring (decode with tools/trace_decode.py)
+// Repository : https://github.com/DennisB66/Simple-WebRadio-Library-for-Arduino
+
+#include <Arduino.h>
+#include "SimpleTrace.h"
+
+// dump layout (all values little endian):
+//   'T' 'R' 'C' <count:1> <lost:2>                         // dump header (lost = overwritten or dropped)
+//   <time:4> <id:1> <seq:1> <arg1:2> <arg2:2>              // count records, oldest first
+
+#ifdef SIMPLE_WEBRADIO_TRACE
+
+struct TraceRecord {
+  uint32_t  time;                                           // event time (micros)
+  uint8_t   id;                                             // event id (TRACE_xxx)
+  uint8_t   seq;                                            // event sequence number (low byte)
+  uint16_t  arg1;                                           // first  event argument
+  uint16_t  arg2;                                           // second event argument
+};
+
+TraceRecord traceRing[ TRACE_RING_SIZE];                    // trace event ring
+uint32_t    traceHead = 0;                                  // total events recorded since clear
+bool        traceHold = false;                              // true = keep first records when full
+uint16_t    traceMask = 0;                                  // bit set = event id skipped
+
+// store event in trace ring
+void traceEvent( uint8_t id, uint16_t a1, uint16_t a2)
+{
+  if (( id < 16) && ( traceMask & ( 1U << id))) return;     // event id skipped
+
+  if ( traceHold && ( traceHead >= TRACE_RING_SIZE)) {      // if ring full in hold mode
+    traceHead++; return;                                    // count event as lost
+  }
+
+  TraceRecord* r = traceRing + ( traceHead & ( TRACE_RING_SIZE - 1));
+
+  r->time = micros();                                       // store event time
+  r->id   = id;                                             // store event id
+  r->seq  = traceHead++;                                    // store sequence number
+  r->arg1 = a1;                                             // store event arguments
+  r->arg2 = a2;
+}
+
+// write value as little endian bytes
+static void _traceWrite( Print& out, uint32_t v, uint8_t size)
+{
+  while ( size--) { out.write((uint8_t) v); v >>= 8; }      // least significant byte first
+}
+
+// write trace ring (binary) and clear it
+void traceDump( Print& out)
+{
+  uint32_t head  = traceHead;                               // snapshot ring state
+  uint8_t  count = min( head, (uint32_t) TRACE_RING_SIZE);  // records still in ring
+
+  out.write( 'T'); out.write( 'R'); out.write( 'C');        // dump header
+  _traceWrite( out, count, 1);                              // number of records
+  _traceWrite( out, min( head - count, (uint32_t) 0xFFFF), 2);
+                                                            // number of records lost
+  uint32_t first = traceHold ? 0 : head - count;            // oldest record still in ring
+
+  for ( uint32_t i = first; i != first + count; i++) {      // oldest record first
+    TraceRecord* r = traceRing + ( i & ( TRACE_RING_SIZE - 1));
+
+    _traceWrite( out, r->time, 4);
+    _traceWrite( out, r->id  , 1);
+    _traceWrite( out, r->seq , 1);
+    _traceWrite( out, r->arg1, 2);
+    _traceWrite( out, r->arg2, 2);
+  }
+
+  traceClear( traceHold);                                   // start a fresh trace
+}
+
+// clear trace ring
+void traceClear( bool hold)
+{
+  traceHead = 0;                                            // forget all records
+  traceHold = hold;                                         // set ring overflow mode
+}
+
+// leave event id (below 16) out of the ring
+void traceSkip( uint8_t id, bool skip)
+{
+  if ( id >= 16) return;                                    // only library events can be skipped
+
+  if ( skip) traceMask |=  ( 1U << id);                     // skip event id
+  else       traceMask &= ~( 1U << id);                     // record event id again
+}
+
+#else
+
+void traceEvent( uint8_t, uint16_t, uint16_t) {}            // trace disabled
+
+// write empty dump (decoder still sees a valid header)
+void traceDump( Print& out)
+{
+  out.write( 'T'); out.write( 'R'); out.write( 'C');        // dump header
+  out.write((uint8_t) 0); out.write((uint8_t) 0); out.write((uint8_t) 0);
+}
+
+void traceClear( bool) {}                                   // trace disabled
+void traceSkip( uint8_t, bool) {}                           // trace disabled
+
+#endif
@@ -0,0 +1,53 @@
+// Copyright  : Dennis Buis (2017)
+// License    : MIT
+// Platform   : Arduino
+// Library    : Simple WebRadio Library for Arduino
+// File       : SimpleTrace.h
+// Purpose    : low-overhead binary trace ring (decode with tools/trace_decode.py)
+// Repository : https://github.com/DennisB66/Simple-WebRadio-Library-for-Arduino
+
+#ifndef _SIMPLE_TRACE_H
+#define _SIMPLE_TRACE_H
+
+#include <Arduino.h>
+
+#define NO_SIMPLE_WEBRADIO_TRACE                            // rename to SIMPLE_WEBRADIO_TRACE to enable
+
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE     32                              // trace records in ring (power of 2, max 128)
+#endif
+
+#if ( TRACE_RING_SIZE & ( TRACE_RING_SIZE - 1)) || ( TRACE_RING_SIZE > 128)
+#error "TRACE_RING_SIZE must be a power of 2 and at most 128"
+#endif
+
+#define TRACE_OPEN           1                              // openICYcastStream  (port, url length)
+#define TRACE_CONNECT        2                              // client connected   (success, connect msec)
+#define TRACE_STOP           3                              // stopICYcastStream  (-, -)
+#define TRACE_READ           4                              // readICYcastStream  (requested, received)
+#define TRACE_STALL          5                              // stream heartbeat   (-, -)
+#define TRACE_HEADER         6                              // header parsed     (bit rate, interval)
+#define TRACE_META           7                              // metadata block     (meta length, info length)
+#define TRACE_PLAY           8                              // _playICYcastStream (skip, bytes played)
+#define TRACE_RESOLVE        9                              // host name resolved (success, resolve msec)
+#define TRACE_REQUEST       10                              // GET request sent   (path length, -)
+#define TRACE_WAIT          11                              // server wait done   (connected, wait msec)
+#define TRACE_ZAP           12                              // station switch     (switch number, preset)
+#define TRACE_FEED          13                              // prebuffer filled   (bytes buffered, target msec)
+#define TRACE_UNDERRUN      14                              // player starved     (gap msec, target msec)
+#define TRACE_RATE          15                              // throughput window  (kbit/s averaged, jitter kbit/s)
+#define TRACE_USER         128                              // first id free for sketch events
+
+#ifdef SIMPLE_WEBRADIO_TRACE
+#define TRACE( id, a1, a2)  traceEvent( id, a1, a2)        // record trace event
+#else
+#define TRACE( id, a1, a2)                                  // trace disabled (no code generated)
+#endif
+
+void traceEvent( uint8_t id, uint16_t a1 = 0, uint16_t a2 = 0);
+                                                            // store event in trace ring
+void traceDump( Print& out);                                // write trace ring (binary) and clear it
+void traceClear( bool hold = false);                        // clear trace ring (hold = keep first records)
+void traceSkip( uint8_t id, bool skip = true);              // leave event id (below 16) out of the ring
+
+#endif
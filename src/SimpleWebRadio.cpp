@@ -8,8 +8,10 @@
 
 #include <Arduino.h>
 #include "SimpleWebRadio.h"
+#include "Dns.h"
 #include "SimpleUtils.h"
 #include "SimplePrint.h"
+#include "SimpleTrace.h"
 
 #define NO_SIMPLE_WEBRADIO_DEBUG_L0
 #define NO_SIMPLE_WEBRADIO_DEBUG_L1
@@ -19,7 +21,17 @@
 VS1053*        player = NULL;                               // radio player object
 EthernetClient client;                                      // HTTP  client object
 
-char playBuffer[ ICY_BUFF_SIZE];                            // ICYcast stream buffer
+char    playBuffer[ ICY_BUFF_SIZE];                         // ICYcast stream buffer
+#if ICY_FEED_SIZE
+uint8_t feedBuffer[ ICY_FEED_SIZE];                         // audio prebuffer (ring)
+#endif
+
+const byte frameRate[2][16] PROGMEM = {                     // MPEG layer III bit rates (kbit/s / 8)
+  { 0, 1, 2, 3,  4,  5,  6,  7,  8, 10, 12, 14, 16, 18, 20, 0 },
+  { 0, 4, 5, 6,  7,  8, 10, 12, 14, 16, 20, 24, 28, 32, 40, 0 },
+};                                                          // [0] = MPEG-2(.5) / [1] = MPEG-1
+
+const word frameFreq[3] PROGMEM = { 44100, 48000, 32000 };  // MPEG-1 sample rates (MPEG-2 / 2, MPEG-2.5 / 4)
 
 // initialize player
 void SimpleRadio::setPlayer( byte _dreq_pin, byte _cs_pin, byte _dcs_pin, byte _reset_pin)
@@ -72,6 +84,12 @@ unsigned int SimpleRadio::getVolume()
   return _volume;                                           // return player volume
 }
 
+// get prebuffer target
+unsigned int SimpleRadio::getTarget()
+{
+  return _feedMsec;                                         // return prebuffer target (msec audio)
+}
+
 // true = station connected
 bool SimpleRadio::connected()
 {
@@ -94,7 +112,7 @@ bool SimpleRadio::available()
 // open ICYcast stream
 bool SimpleRadio::openICYcastStream( PresetInfo* preset)
 {
-  //PRINT( F( "> openICYcastStream")) LF;
+  TRACE( TRACE_OPEN, preset->port, strlen( preset->url));
 
   strcpy_P( _name, PSTR( "< ---------- >"));                // initialize station name
   strcpy_P( _info, PSTR( "< ---------- >"));                // initialize station info
@@ -112,6 +130,10 @@ bool SimpleRadio::openICYcastStream( PresetInfo* preset)
     }
 
     IPAddress hostIP( preset->ip4);                         // extract host IP from presetData
+    bool      hostOK = true;                                // true = host IP known
+    #ifdef SIMPLE_WEBRADIO_TRACE
+    unsigned long start = millis();                         // start of resolve / connect phase
+    #endif
 
     PRINT( F( "# searching "));
     if ( strlen( host) > 0) {
@@ -120,16 +142,27 @@ bool SimpleRadio::openICYcastStream( PresetInfo* preset)
       LABEL( F( "/")    , path + 1);
       #endif
 
-      client.connect( host, preset->port);                  // connect to ICYcast server
+      DNSClient dns;                                        // resolve host name separately
+      dns.begin( Ethernet.dnsServerIP());                   // (same lookup as client.connect( host))
+      hostOK = dns.getHostByName( host, hostIP) == 1;       // so its latency can be traced
+
+      TRACE( TRACE_RESOLVE, hostOK, millis() - start);
+      #ifdef SIMPLE_WEBRADIO_TRACE
+      start = millis();                                     // start of connect phase
+      #endif
     } else {
       #ifdef SIMPLE_WEBRADIO_DEBUG_L0                       // print debug info
       VALUE( F( "host"), hostIP);
       VALUE( F( ":")   , preset->port);
       #endif
+    }
 
+    if ( hostOK) {                                          // if host IP known
       client.connect( hostIP, preset->port);                // connect to ICYcast server
     }
 
+    TRACE( TRACE_CONNECT, client.connected(), millis() - start);
+
     if ( client.connected()) {                              // if connection is successful
       client.print  ( F( "GET /" )); client.print  ( path + 1); client.println( F( " HTTP/1.0"));
       client.print  ( F( "Host: ")); client.println( host    );
@@ -138,6 +171,7 @@ bool SimpleRadio::openICYcastStream( PresetInfo* preset)
     //client.println( F( "Connection: close"));
       client.println();                                     // send ICYcast streaming request
 
+      TRACE( TRACE_REQUEST, strlen( path + 1), 0);
       PRINT( F( "> success!")) LF;                          // client connected
     } else {
       PRINT( F( "> failure!")) LF;                          // client not connected
@@ -153,7 +187,27 @@ bool SimpleRadio::openICYcastStream( PresetInfo* preset)
   _dataLeft = _interval;                                    // bytes left to receive
   _dataHead = false;                                        // false = ICYcast header not received
 
-  delay( 500);                                              // give server chance to respond
+  _feedRead    = 0;                                         // empty prebuffer
+  _feedFill    = 0;
+  _feedLevel   = 0;                                         // player buffer empty (after stopSong)
+  _feedBoost   = 0;                                         // forget underruns of previous station
+  _feedPlay    = false;                                     // false = prebuffering
+  _bitRate     = 0;                                         // bit rate still undetermined
+  _rateIn      = 0;                                         // forget throughput of previous station
+  _rateJitter  = 0;
+  _rateGap     = 0;
+  _rateBytes   = 0;
+  _rateCushion = 0;
+  _rateFull    = false;
+  _frameRate   = 0;                                         // no frame header candidate
+
+  _sizeICYcastBuffer();                                     // target for default bit rate
+
+  delay( ICY_WAIT_TIME);                                    // give server chance to respond
+
+  TRACE( TRACE_WAIT, client.connected(), ICY_WAIT_TIME);
+
+  _rateStart = _rateLast = _feedTime = millis();            // start measuring throughput
 
   return client.connected();                                // true = client connected to ICYcast server
 }
@@ -161,7 +215,7 @@ bool SimpleRadio::openICYcastStream( PresetInfo* preset)
 // stop ICYcast stream
 void SimpleRadio::stopICYcastStream()
 {
-  // PRINT( F( "> stopICYcastStream")) lF;
+  TRACE( TRACE_STOP, 0, 0);
 
   if ( player) player->stopSong();                          // stop radio player
   client.stop();                                            // disconnect from ICYcast server
@@ -170,7 +224,7 @@ void SimpleRadio::stopICYcastStream()
 // recieve ICYcast stream data
 void SimpleRadio::readICYcastStream()
 {
-  static Stopwatch sw( 2000); if (sw.check()) _dataStop = true;
+  static Stopwatch sw( 2000); if (sw.check()) { _dataStop = true; TRACE( TRACE_STALL, 0, 0); }
                                                             // check heartbeat every 2 sec
   if ( client.connected() && client.available()) {          // if ICYcast stream data available
     _dataLast = client.read((uint8_t*) playBuffer, _dataNext);
@@ -180,22 +234,17 @@ void SimpleRadio::readICYcastStream()
       sw.reset();                                           // reset stopwatch
     }
 
-    // VALUE( F( "> readICYcastStream > total = "), _dataLeft);
-    // VALUE( F( " / count = "), _dataNext)   ;
-    // VALUE( F( " / "        ), _dataLast) LF;
+    TRACE( TRACE_READ, _dataNext, _dataLast);
   } else {
     _dataLast = 0;                                          // client not connected
   }
 
+  _rateICYcastStream( _dataLast);                           // measure inbound throughput
 }
 
 // process ICYcast stream header
 void SimpleRadio::hndlICYcastHeader()
 {
-  // VALUE( F( "> hndlICYcastHeader > tot = "), _dataLeft);
-  // VALUE( F( " / req = "), _dataNext)   ;
-  // VALUE( F( " / rec = "), _dataLast) LF;
-
   char iVal[PRESET_SIZE_LENGTH]; strcpy( iVal, "0");        // data interval string
 
   bool found = false;                                       // found = meta data found
@@ -209,6 +258,8 @@ void SimpleRadio::hndlICYcastHeader()
   _dataHead = found;                                        // true = header received
   _dataDisp = found;                                        // true = (new) info to be displayed
 
+  _bitRate  = atoi( _rate);                                 // advertised bit rate (0 = unknown)
+
   #ifdef SIMPLE_WEBRADIO_DEBUG_L1
   VALUE( F( "name = "), _name);
   VALUE( F( "type = "), _type);
@@ -218,20 +269,18 @@ void SimpleRadio::hndlICYcastHeader()
 
   int skip = _findICYcastHeader( PSTR( "\r\n\r\n"));        // find end of header
 
-  // VALUE( F( "> hndlICYcastHeader > header length = "), skip + 4) LF;
-
   if ( skip) {                                              // if end of header found
+    TRACE( TRACE_HEADER, _bitRate, _interval);
+
+    _sizeICYcastBuffer();                                   // target for advertised bit rate
     _playICYcastStream( skip + 4, true);                    // play audio part of data stream
+    _feedICYcastBuffer();                                   // feed player (if prebuffer filled)
   }
 }
 
 // process ICYcast stream audio data
 void SimpleRadio::hndlICYcastStream()
 {
-  // VALUE( F( "> hndlICYcastStream > tot = "), _dataLeft);
-  // VALUE( F( " / req = "), _dataNext)   ;
-  // VALUE( F( " / rec = "), _dataLast) LF;
-
   if (( _dataLast > 0) && ( _dataLeft != 0)) {              // if bytes to play
     _playICYcastStream();                                   // play audio stream
   } else
@@ -244,26 +293,26 @@ void SimpleRadio::hndlICYcastStream()
 
       _dataDisp = true;                                     // true = (new) info to be displayed
 
-      #ifdef SIMPLE_WEBRADIO_DEBUG_L1
-      VALUE( "> metadata = ", skip);
-      VALUE( " / ", _info);
-      #endif
+      TRACE( TRACE_META, skip, strlen( _info));
     }
 
     _playICYcastStream( skip + 1, true);                    // play audio part of data stream
   }
 
+  _feedICYcastBuffer();                                     // feed player (if prebuffer filled)
 }
 
 void SimpleRadio::_playICYcastStream( unsigned int skip, bool reset)
 {
-  // VALUE( F( "> playICYcastStream > tot = "), _dataLeft);
-  // VALUE( F( " / req = "), _dataNext)   ;
-  // VALUE( F( " / rec = "), _dataLast) LF;
+  TRACE( TRACE_PLAY, skip, _dataLast - skip);
 
-  if ( player) {
-    player->playChunk((uint8_t*) playBuffer + skip, _dataLast - skip);
-  }                                                         // play audio part of data stream
+  if (( _bitRate == 0) && ( _dataLast > skip)) {            // if no bit rate advertised
+    _bitRate = _findFrameBitRate((uint8_t*) playBuffer + skip, _dataLast - skip);
+    if ( _bitRate) _sizeICYcastBuffer();                    // target for frame bit rate
+  }
+
+  _fillICYcastBuffer((uint8_t*) playBuffer + skip, _dataLast - skip);
+                                                            // store audio part of data stream
 
   if ( skip > 0) {                                          // skip = non-audio bytes
     _dataLeft = (  _interval > 0) ? _interval : ICY_BUFF_SIZE;
@@ -273,6 +322,224 @@ void SimpleRadio::_playICYcastStream( unsigned int skip, bool reset)
   _dataNext = (( _dataLeft > 0) && ( _dataLeft < ICY_BUFF_SIZE)) ? _dataLeft : ICY_BUFF_SIZE;
 }                                                           // set next chunk size
 
+// store audio data in prebuffer
+void SimpleRadio::_fillICYcastBuffer( uint8_t* data, unsigned int size)
+{
+  #if ICY_FEED_SIZE
+  while ( size > 0) {                                       // while data left to store
+    if ( _feedFill == ICY_FEED_SIZE) {                      // if prebuffer full
+      _rateFull = true;                                     // throughput now limited by player
+      _feedICYcastBuffer( true);                            // wait for player to free space
+    }
+
+    unsigned int head = ( _feedRead + _feedFill) % ICY_FEED_SIZE;
+    unsigned int n    = min( size, min( ICY_FEED_SIZE - _feedFill, ICY_FEED_SIZE - head));
+
+    memcpy( feedBuffer + head, data, n);                    // copy up to end of ring
+    _feedFill += n; data += n; size -= n;
+  }
+  #else
+  if ( !_feedPlay && ( size > 0)) {                         // no prebuffer: play at once
+    _feedPlay = true;
+    TRACE( TRACE_FEED, size, _feedMsec);
+  }
+
+  _sendICYcastPlayer( data, size);                          // (blocks on DREQ)
+  #endif
+}
+
+// feed prebuffer to player (force = wait for player to take one chunk)
+void SimpleRadio::_feedICYcastBuffer( bool force)
+{
+  #if ICY_FEED_SIZE
+  _levelICYcastPlayer();                                    // update player buffer estimate
+
+  if ( !_feedPlay) {                                        // if still prebuffering
+    unsigned int need = min( _feedTarget, ICY_FEED_ROOM + _feedLevel);
+                                                            // cushion reachable before playing
+    if (( _feedFill + _feedLevel < need) && !force) return; // wait until cushion reached
+
+    _feedPlay = true;                                       // start feeding player
+    TRACE( TRACE_FEED, _feedFill + _feedLevel, _feedMsec);
+  }
+
+  while ( _feedFill > 0) {                                  // while audio in prebuffer
+    if ( player && !force && !player->data_request()) {     // if player busy (DREQ low)
+      _feedLevel = ICY_FEED_FIFO;                           // player buffer is full
+      break;
+    }
+
+    unsigned int n = min( _feedFill, min( ICY_FEED_CHUNK, ICY_FEED_SIZE - _feedRead));
+
+    _sendICYcastPlayer( feedBuffer + _feedRead, n);         // play one chunk (blocks on DREQ)
+    _feedRead = ( _feedRead + n) % ICY_FEED_SIZE;
+    _feedFill -= n;
+
+    if ( force) break;                                      // space freed
+  }
+  #else
+  _levelICYcastPlayer();                                    // update player buffer estimate
+  #endif
+
+  _rateCushion = _feedFill + _feedLevel;                    // audio buffered after last data
+}
+
+// send audio data to player
+void SimpleRadio::_sendICYcastPlayer( uint8_t* data, unsigned int size)
+{
+  if ( player) {
+    if ( !player->data_request()) {                         // if player buffer full
+      _feedLevel = ICY_FEED_FIFO;
+      _rateFull  = true;                                    // throughput now limited by player
+    }
+    player->playChunk( data, size);                         // play data (blocks on DREQ)
+  }
+
+  _levelICYcastPlayer();                                    // account time spent waiting
+  _feedLevel = min((unsigned long) ICY_FEED_FIFO, (unsigned long) _feedLevel + size);
+}
+
+// estimate player buffer level (drains at bit rate while playing)
+void SimpleRadio::_levelICYcastPlayer()
+{
+  unsigned long now  = millis();
+  unsigned long used = ( now - _feedTime) * _findAudioRate() / 8;
+                                                            // msec * kbit/s / 8 = bytes
+  if ( !_feedPlay) {                                        // nothing playing
+    _feedTime = now;
+  } else
+  if ( used > 0) {                                          // if bytes played since last estimate
+    _feedLevel = ( used < _feedLevel) ? _feedLevel - used : 0;
+    _feedTime  = now;
+  }
+}
+
+// measure inbound throughput (bytes = received since last call)
+void SimpleRadio::_rateICYcastStream( unsigned int bytes)
+{
+  unsigned long now = millis();
+
+  if ( bytes > 0) {                                         // if data received
+    unsigned long gap = now - _rateLast;                    // time since previous data
+
+    _rateGap    = max((unsigned long) _rateGap, gap);       // track longest gap between data
+    _rateLast   = now;
+    _rateBytes += bytes;
+
+    if ( _feedPlay && ( gap * _findAudioRate() / 8 > _rateCushion)) {
+                                                            // if gap longer than audio buffered
+      _feedPlay   = false;                                  // player starved: refill prebuffer first
+      _feedLevel  = 0;                                      // player buffer ran empty
+      _feedBoost  = min( _feedBoost + ICY_FEED_STEP, ICY_FEED_BOOST);
+      _sizeICYcastBuffer();                                 // keep more cushion from now on
+
+      TRACE( TRACE_UNDERRUN, gap, _feedMsec);
+    }
+  }
+
+  if ( now - _rateStart >= ICY_RATE_WINDOW) {               // if end of measurement window
+    unsigned int rate = ( _rateBytes * 8 + ( now - _rateStart) / 2) / ( now - _rateStart);
+                                                            // bits per msec = kbit/s (rounded)
+    if ( !_rateFull) {                                      // skip windows limited by the player
+      if ( _rateIn) {                                       // average over windows (1/4 weight)
+        _rateJitter = ( 3 * _rateJitter + abs((long) rate - (long) _rateIn) + 2) / 4;
+        _rateIn     = ( 3 * _rateIn     + rate + 2) / 4;
+      } else {
+        _rateIn     = rate;                                 // first window
+      }
+    }
+
+    TRACE( TRACE_RATE, _rateIn, _rateJitter);
+
+    _sizeICYcastBuffer();                                   // adjust cushion target
+
+    _rateGap   -= _rateGap / 4;                             // let old gaps fade out
+    _rateStart  = now;                                      // start next window
+    _rateBytes  = 0;
+    _rateFull   = false;
+  }
+}
+
+// set cushion target (prebuffer + player buffer) from bit rate, throughput and jitter
+void SimpleRadio::_sizeICYcastBuffer()
+{
+  unsigned int  rate = _findAudioRate();                    // audio bit rate (kbit/s)
+  unsigned long msec = ICY_FEED_MIN + _feedBoost;           // base cushion (msec audio)
+
+  msec += max((unsigned long) _rateGap, (unsigned long) ICY_RATE_WINDOW * _rateJitter / rate);
+                                                            // cover longest gap or one slow window
+  if ( _rateIn && ( _rateIn < rate - rate / 16)) {          // if link barely keeps up
+    msec += ICY_FEED_STEP;                                  // add extra cushion
+  }
+
+  unsigned long size = min( msec * rate / 8, (unsigned long) ( ICY_FEED_ROOM + ICY_FEED_FIFO));
+                                                            // msec * kbit/s / 8 = bytes (RAM limit)
+  _feedTarget = size;                                       // bytes buffered before playing
+  _feedMsec   = size * 8 / rate;                            // target in msec audio (after RAM limit)
+}
+
+// bit rate used for buffer sizing (kbit/s)
+unsigned int SimpleRadio::_findAudioRate()
+{
+  if ( _bitRate) return _bitRate;                           // advertised or frame bit rate
+  if ( _rateIn ) return _rateIn;                            // measured throughput
+
+  return ICY_RATE_DEFAULT;                                  // nothing known yet
+}
+
+// bit rate from two successive MPEG layer III frame headers (0 = not found yet)
+unsigned int SimpleRadio::_findFrameBitRate( uint8_t* data, unsigned int size)
+{
+  unsigned int rate, next;
+
+  if ( _frameRate) {                                        // if header found in previous data
+    if ( _frameSkip >= size) {                              // if next header not in this data
+      _frameSkip -= size; return 0;
+    }
+    if (( _frameSkip + 3 <= size) && _findFrameLength( data + _frameSkip, &next)) {
+      return _frameRate;                                    // next header confirms bit rate
+    }
+    _frameRate = 0;                                         // false sync: search again
+  }
+
+  for ( unsigned int i = 0; i + 3 <= size; i++) {           // search frame header
+    unsigned int length = _findFrameLength( data + i, &rate);
+
+    if ( length == 0) continue;                             // no (valid) header
+
+    if ( i + length >= size) {                              // if next header in next data
+      _frameRate = rate;                                    // confirm later
+      _frameSkip = i + length - size;
+      return 0;
+    }
+    if (( i + length + 3 <= size) && _findFrameLength( data + i + length, &next)) {
+      return rate;                                          // next header confirms bit rate
+    }
+  }
+
+  return 0;                                                 // no confirmed header found
+}
+
+// frame length + bit rate of MPEG layer III frame header (0 = no valid header)
+unsigned int SimpleRadio::_findFrameLength( uint8_t* h, unsigned int* rate)
+{
+  if (( h[ 0] != 0xFF) || (( h[ 1] & 0xE0) != 0xE0)) return 0;
+                                                            // no frame sync (11 bits set)
+  byte version = ( h[ 1] >> 3) & 0x03;                      // 00 = MPEG-2.5, 01 = reserved, 10 = MPEG-2, 11 = MPEG-1
+  byte layer   = ( h[ 1] >> 1) & 0x03;                      // 01 = layer III
+  byte index   =   h[ 2] >> 4;                              // bit rate index (0 = free, 15 = bad)
+  byte freq    = ( h[ 2] >> 2) & 0x03;                      // sample rate index (3 = reserved)
+  byte pad     = ( h[ 2] >> 1) & 0x01;                      // padding byte
+
+  if (( version == 1) || ( layer != 1) || ( index == 0) || ( index == 15) || ( freq == 3)) return 0;
+
+  *rate = pgm_read_byte( &frameRate[ version == 3][ index]) * 8;
+
+  unsigned long hz = pgm_read_word( &frameFreq[ freq]) >> (( version == 3) ? 0 : ( version == 2) ? 1 : 2);
+
+  return (( version == 3) ? 144000UL : 72000UL) * *rate / hz + pad;
+}
+
 // find label in ICYcast stream data
 int SimpleRadio::_findICYcastHeader( const char* label)
 {
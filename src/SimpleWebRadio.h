@@ -25,6 +25,25 @@
 #define PRESET_META_LENGTH 128                              // max name length
 
 #define ICY_BUFF_SIZE      600                              // play buffer length
+#define ICY_WAIT_TIME      500                              // msec to give server chance to respond
+
+#ifndef ICY_FEED_SIZE                                       // only set as global build flag (e.g. -DICY_FEED_SIZE=2048),
+#define ICY_FEED_SIZE        0                              // audio prebuffer length (RAM limit, 0 = no prebuffer)
+#endif                                                      // a #define in the sketch does not reach this library
+#define ICY_FEED_CHUNK      32                              // bytes per player transfer (guaranteed by DREQ)
+#define ICY_FEED_FIFO     2048                              // player (VS1053) input buffer length
+#define ICY_FEED_MIN        50                              // min cushion target (msec audio)
+#define ICY_FEED_STEP       50                              // target increase per underrun (msec audio)
+#define ICY_FEED_BOOST     400                              // max target increase by underruns (msec audio)
+#define ICY_RATE_WINDOW   1000                              // throughput measurement window (msec)
+#define ICY_RATE_DEFAULT   128                              // bit rate assumed until known (kbit/s)
+
+#if ICY_FEED_SIZE && ( ICY_FEED_SIZE <= ICY_BUFF_SIZE)
+#error "ICY_FEED_SIZE must be 0 or larger than ICY_BUFF_SIZE"
+#endif
+
+#define ICY_FEED_ROOM ( ICY_FEED_SIZE ? ICY_FEED_SIZE - ICY_BUFF_SIZE : 0)
+                                                            // prebuffer bytes usable before playing
 
 struct PresetInfo {
   char      url[PRESET_PATH_LENGTH];                        // preset HTTP url
@@ -44,6 +63,8 @@ public:
   void          setVolume( int);                            // set player volume
   unsigned int  getVolume();                                // get player volume
 
+  unsigned int  getTarget();                                // get cushion target (msec audio)
+
   bool connected();                                         // true = stream connected
   bool available();                                         // true = stream data available
   bool receiving();                                         // true = stream keeps active
@@ -71,9 +92,40 @@ private:
   bool          _dataDisp;                                  // true = new meta data available
   bool          _dataStop;                                  // true = stream time-out occured
 
+  unsigned int  _feedRead;                                  // prebuffer read position
+  unsigned int  _feedFill;                                  // prebuffer bytes stored
+  unsigned int  _feedLevel;                                 // player buffer bytes (estimated)
+  unsigned long _feedTime;                                  // time of last player buffer estimate
+  unsigned int  _feedTarget;                                // cushion bytes (prebuffer + player buffer)
+  unsigned int  _feedMsec;                                  // cushion target (msec audio)
+  unsigned int  _feedBoost;                                 // extra target after underruns (msec)
+  bool          _feedPlay;                                  // true = prebuffer filled, feeding player
+
+  unsigned int  _bitRate;                                   // stream bit rate (advertised or from frame)
+  unsigned int  _rateIn;                                    // measured throughput (kbit/s, averaged)
+  unsigned int  _rateJitter;                                // throughput deviation (kbit/s, averaged)
+  unsigned int  _rateGap;                                   // longest gap between reads (msec, decaying)
+  unsigned long _rateStart;                                 // start of measurement window
+  unsigned long _rateLast;                                  // time of last received data
+  unsigned long _rateBytes;                                 // bytes received in window
+  unsigned int  _rateCushion;                               // bytes buffered after last data
+  bool          _rateFull;                                  // true = window throttled by player
+
+  unsigned int  _frameRate;                                 // bit rate of unconfirmed frame header
+  unsigned int  _frameSkip;                                 // bytes to next frame header (to confirm)
+
   int   _findICYcastHeader( const char*);                   // find label in ICYcast stream data
   int   _findICYcastHeader( const char*, char*, int);       // find value in ICYcast stream data
-  void  _playICYcastStream( unsigned int = 0, bool = false);
-};                                                          // play stream data
+  void  _playICYcastStream( unsigned int = 0, bool = false);// play stream data
+  void  _fillICYcastBuffer( uint8_t*, unsigned int);        // store audio data in prebuffer
+  void  _feedICYcastBuffer( bool = false);                  // feed prebuffer to player
+  void  _sendICYcastPlayer( uint8_t*, unsigned int);        // send audio data to player
+  void  _levelICYcastPlayer();                              // estimate player buffer level
+  void  _rateICYcastStream( unsigned int);                  // measure inbound throughput
+  void  _sizeICYcastBuffer();                               // set prebuffer target
+  unsigned int _findAudioRate();                            // bit rate used for buffer sizing
+  unsigned int _findFrameBitRate( uint8_t*, unsigned int);  // bit rate from MPEG frame headers
+  unsigned int _findFrameLength( uint8_t*, unsigned int*);  // frame length + bit rate of frame header
+};
 
 #endif
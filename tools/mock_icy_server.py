@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+# Copyright  : Dennis Buis (2017)
+# License    : MIT
+# Platform   : host (Python 3)
+# Library    : Simple WebRadio Library for Arduino
+# File       : mock_icy_server.py
+# Purpose    : local ICYcast server with configurable latency for zapping benchmarks
+# Repository : https://github.com/DennisB66/Simple-WebRadio-Library-for-Arduino
+#
+# usage: mock_icy_server.py [--port 8000] [--rtt 40] [--header-delay 100]
+#                           [--bandwidth 256] [--bitrate 128] [--metaint 8192]
+#                           [--dns 192.168.1.10] [--dns-port 53]
+#
+# Every path is served as a station: the request is read rtt/2 msec after the
+# connection is accepted and the ICY header is sent rtt/2 + header-delay msec
+# later, followed by silent MP3 frames (with metadata blocks every metaint
+# bytes) paced at the given bandwidth from the moment the header is sent.
+#
+# The library reads the header once, ICY_WAIT_TIME (500) msec after sending the
+# request: rtt + header-delay above that is not supported (the switch then
+# fails without header and is reported as incomplete by zap_bench.py).
+#
+# With --dns the server also answers every DNS A query on udp port 53 with the
+# given address (after rtt msec), so host name presets resolve to this server.
+# Port 53 needs root rights; --dns-port selects another port for testing.
+#
+# The rtt is added at application level only: the TCP handshake and the
+# streamed data are not delayed. Use 'tc qdisc ... netem delay' on the pc for
+# a real network round trip.
+
+import argparse
+import socket
+import socketserver
+import struct
+import threading
+import time
+
+BITRATES = [0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320]
+
+
+def silent_frame(bitrate):
+    """Return one silent MPEG-1 layer III frame (44.1 kHz, no padding)."""
+    index = BITRATES.index(bitrate)
+    header = bytes([0xFF, 0xFB, (index << 4) | 0x00, 0xC4])  # 44.1 kHz, mono
+    size = 144000 * bitrate // 44100                         # frame length in bytes
+    return header + bytes(size - len(header))
+
+
+class ICYHandler(socketserver.BaseRequestHandler):
+    def handle(self):
+        opts = self.server.opts
+        sock = self.request
+        sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        accepted = time.monotonic()
+
+        time.sleep(opts.rtt / 2000.0)                       # request travels to server
+        request = b""
+        while b"\r\n\r\n" not in request:                    # read request header
+            data = sock.recv(512)
+            if not data:
+                return
+            request += data
+        path = request.split(b" ")[1].decode(errors="replace") if b" " in request else "/"
+
+        time.sleep((opts.rtt / 2 + opts.header_delay) / 1000.0)
+                                                            # server work + reply travels back
+        header = ("ICY 200 OK\r\n"
+                  "icy-name:Mock %s\r\n"
+                  "icy-genre:Benchmark\r\n"
+                  "icy-br:%d\r\n"
+                  "icy-metaint:%d\r\n"
+                  "\r\n" % (path, opts.bitrate, opts.metaint)).encode()
+
+        try:
+            sock.sendall(header)
+            self.stream(sock, time.monotonic())             # pace audio from end of header
+        except OSError:
+            pass                                            # client zapped away
+        print("%-20s %s  %6.0f msec" % (self.client_address[0], path,
+                                        (time.monotonic() - accepted) * 1000))
+
+    def stream(self, sock, start):
+        opts = self.server.opts
+        frame = silent_frame(opts.bitrate)
+        rate = opts.bandwidth * 1000 / 8.0                  # bytes per second
+        sent = 0
+        left = opts.metaint                                 # audio bytes to next metadata
+        count = 0
+        audio = b""
+
+        while True:
+            if len(audio) < 512:
+                audio += frame
+            chunk = audio[:min(512, left)]
+            audio = audio[len(chunk):]
+            left -= len(chunk)
+
+            if left == 0:                                   # append metadata block
+                count += 1
+                text = ("StreamTitle='Mock track %d';" % count).encode()
+                blocks = (len(text) + 15) // 16
+                chunk += bytes([blocks]) + text.ljust(blocks * 16, b"\0")
+                left = opts.metaint
+
+            sock.sendall(chunk)
+            sent += len(chunk)
+
+            ahead = sent / rate - (time.monotonic() - start)  # pace to bandwidth
+            if ahead > 0:
+                time.sleep(ahead)
+
+
+class ICYServer(socketserver.ThreadingTCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+
+class DNSHandler(socketserver.BaseRequestHandler):
+    def handle(self):
+        opts = self.server.opts
+        query, sock = self.request
+        if len(query) < 12:
+            return
+
+        end = 12                                            # skip question name (labels)
+        while end < len(query) and query[end] != 0:
+            end += query[end] + 1
+        end += 5                                            # zero label, qtype, qclass
+        if end > len(query):
+            return
+        qtype = struct.unpack_from(">H", query, end - 4)[0]
+
+        answer = b""
+        if qtype == 1:                                      # A record: point at this server
+            answer = struct.pack(">HHHIH", 0xC00C, 1, 1, 60, 4) + socket.inet_aton(opts.dns)
+        reply = (query[:2] + struct.pack(">HHHHH", 0x8180, 1, 1 if answer else 0, 0, 0) +
+                 query[12:end] + answer)
+
+        time.sleep(opts.rtt / 1000.0)                       # query + reply travel time
+        sock.sendto(reply, self.client_address)
+
+
+class DNSServer(socketserver.ThreadingUDPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+
+def main():
+    parser = argparse.ArgumentParser(description="mock ICYcast server")
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--rtt", type=float, default=40, help="round trip time (msec)")
+    parser.add_argument("--header-delay", type=float, default=100, help="server header delay (msec)")
+    parser.add_argument("--bandwidth", type=float, default=256, help="link bandwidth (kbit/s)")
+    parser.add_argument("--bitrate", type=int, default=128, choices=BITRATES[1:], help="stream bit rate (kbit/s)")
+    parser.add_argument("--metaint", type=int, default=8192, help="metadata interval (bytes)")
+    parser.add_argument("--dns", help="answer DNS A queries with this address")
+    parser.add_argument("--dns-port", type=int, default=53, help="DNS server port (udp)")
+    opts = parser.parse_args()
+
+    if opts.rtt + opts.header_delay >= 500:                 # ICY_WAIT_TIME in SimpleWebRadio.h
+        print("# warning: rtt + header delay >= 500 msec, the library will miss the header")
+
+    server = ICYServer(("", opts.port), ICYHandler)
+    server.opts = opts
+
+    if opts.dns:                                            # resolve host name presets
+        dns = DNSServer(("", opts.dns_port), DNSHandler)
+        dns.opts = opts
+        threading.Thread(target=dns.serve_forever, daemon=True).start()
+        print("# mock DNS server resolving every name to %s" % opts.dns)
+    print("# mock ICYcast server on port %d (rtt %g msec, header delay %g msec, %g kbit/s)" %
+          (opts.port, opts.rtt, opts.header_delay, opts.bandwidth))
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
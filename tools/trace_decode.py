@@ -0,0 +1,113 @@
+#!/usr/bin/env python3
+# Copyright  : Dennis Buis (2017)
+# License    : MIT
+# Platform   : host (Python 3)
+# Library    : Simple WebRadio Library for Arduino
+# File       : trace_decode.py
+# Purpose    : decode binary trace dumps written by traceDump() (see src/SimpleTrace.h)
+# Repository : https://github.com/DennisB66/Simple-WebRadio-Library-for-Arduino
+#
+# usage: trace_decode.py [capture.bin]         (reads stdin when no file is given)
+#
+# The capture may contain ordinary Serial text around the dumps; every
+# 'TRC' header found in the byte stream is decoded as one dump.
+
+import struct
+import sys
+
+MAGIC = b"TRC"
+HEAD = struct.Struct("<BH")                                 # count, lost
+RECORD = struct.Struct("<IBBHH")                            # time, id, seq, arg1, arg2
+MAX_RECORDS = 128                                           # largest TRACE_RING_SIZE
+
+EVENTS = {                                                  # keep in sync with SimpleTrace.h
+     1: ("open",    "port",      "url len"),
+     2: ("connect", "success",   "msec"),
+     3: ("stop",    "-",         "-"),
+     4: ("read",    "requested", "received"),
+     5: ("stall",   "-",         "-"),
+     6: ("header",  "bit rate",  "interval"),
+     7: ("meta",    "meta len",  "info len"),
+     8: ("play",    "skip",      "played"),
+     9: ("resolve", "success",   "msec"),
+    10: ("request", "path len",  "-"),
+    11: ("wait",    "connected", "msec"),
+    12: ("zap",     "switch",    "preset"),
+    13: ("feed",    "buffered",  "target msec"),
+    14: ("underrun", "gap msec", "target msec"),
+    15: ("rate",    "kbit/s",    "jitter"),
+}
+
+
+def parse_dumps(data):
+    """Yield (lost, records) for every dump found in data."""
+    pos = data.find(MAGIC)
+    while pos >= 0:
+        dump = parse_dump(data, pos + len(MAGIC))
+        if dump is None:                                    # 'TRC' in Serial text or truncated dump
+            pos = data.find(MAGIC, pos + 1)
+            continue
+        end, lost, records = dump
+        yield lost, records
+        pos = data.find(MAGIC, end)
+
+
+def parse_dump(data, start):
+    """Return (end, lost, records) for the dump at start, None when not a valid dump."""
+    if start + HEAD.size > len(data):
+        return None
+    count, lost = HEAD.unpack_from(data, start)
+    start += HEAD.size
+    end = start + count * RECORD.size
+    if count > MAX_RECORDS or end > len(data):
+        return None
+    records = [RECORD.unpack_from(data, start + i * RECORD.size) for i in range(count)]
+    for prev, record in zip(records, records[1:]):
+        if record[2] != (prev[2] + 1) & 0xFF:               # sequence numbers must follow up
+            return None
+    return end, lost, records
+
+
+def event_name(ident):
+    if ident in EVENTS:
+        return EVENTS[ident]
+    if ident >= 128:
+        return ("user+%d" % (ident - 128), "arg1", "arg2")
+    return ("id %d" % ident, "arg1", "arg2")
+
+
+def print_dump(index, lost, records):
+    print("# dump %d: %d records, %d lost" % (index, len(records), lost))
+    if not records:
+        return
+    first = records[0][0]
+    prev = first
+    for time, ident, seq, arg1, arg2 in records:
+        name, label1, label2 = event_name(ident)
+        rel = (time - first) & 0xFFFFFFFF                   # micros() wraps after ~71 min
+        delta = (time - prev) & 0xFFFFFFFF
+        prev = time
+        print("%3d %12d us %+10d us  %-8s %s=%d %s=%d" %
+              (seq, rel, delta, name, label1, arg1, label2, arg2))
+
+
+def main(argv):
+    if len(argv) > 1:
+        with open(argv[1], "rb") as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+
+    found = 0
+    for index, (lost, records) in enumerate(parse_dumps(data)):
+        print_dump(index, lost, records)
+        found += 1
+
+    if not found:
+        sys.stderr.write("no trace dump found\n")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+# Copyright  : Dennis Buis (2017)
+# License    : MIT
+# Platform   : host (Python 3)
+# Library    : Simple WebRadio Library for Arduino
+# File       : zap_bench.py
+# Purpose    : per-phase tune-to-first-audio latency from WebRadio-Zap-Benchmark trace dumps
+# Repository : https://github.com/DennisB66/Simple-WebRadio-Library-for-Arduino
+#
+# usage: zap_bench.py capture.bin [--csv switches.csv]
+#
+# Each dump written by the benchmark sketch holds one station switch, starting
+# with a 'zap' event. The switch is split in phases ending at these events:
+#
+#   stop      zap      -> open        stopICYcastStream()
+#   resolve   open     -> resolve     DNS lookup (0 when the preset holds an IP)
+#   connect   resolve  -> connect     TCP connect
+#   request   connect  -> request     sending the GET request
+#   wait      request  -> wait        fixed delay in openICYcastStream()
+#   header    wait     -> header      reading + parsing the ICY header
+#   audio     header   -> feed        filling the prebuffer until the player is fed
+#   total     zap      -> feed
+#
+# A resolve, connect or wait event only ends its phase when it reports success.
+# A switch that fails or misses an event is incomplete: the phases it finished
+# are counted, but it is left out of the total and listed by failed phase.
+
+import argparse
+import math
+import sys
+
+from trace_decode import parse_dumps
+
+PHASES = ["stop", "resolve", "connect", "request", "wait", "header", "audio", "total"]
+
+ZAP, OPEN, CONNECT, HEADER, RESOLVE, REQUEST, WAIT, FEED = 12, 1, 2, 6, 9, 10, 11, 13
+
+CHECKED = (RESOLVE, CONNECT, WAIT)                          # events with arg1 = success
+
+
+def first(records, ident, after=0):
+    """Return first record with ident at or after time after."""
+    for record in records:
+        if record[1] == ident and record[0] >= after:
+            return record
+    return None
+
+
+def split_switch(records):
+    """Return (dict phase -> msec, failed phase or None) for one switch (None without zap event)."""
+    zap = first(records, ZAP)
+    if zap is None:
+        return None
+    zap = zap[0]
+    records = [r for r in records if ((r[0] - zap) & 0xFFFFFFFF) < 0x80000000]
+    records = [((r[0] - zap) & 0xFFFFFFFF,) + r[1:] for r in records]   # micros since zap
+
+    marks = [0]
+    for ident in (OPEN, RESOLVE, CONNECT, REQUEST, WAIT, HEADER, FEED):
+        record = first(records, ident, marks[-1])
+        if record is None and ident == RESOLVE:
+            marks.append(marks[-1])                         # preset with IP: no lookup
+            continue
+        if record is None or (ident in CHECKED and record[3] != 1):
+            break                                           # missing or failed phase
+        marks.append(record[0])
+
+    result = {}
+    for name, begin, end in zip(PHASES, marks, marks[1:]):
+        result[name] = (end - begin) / 1000.0
+
+    if len(marks) < len(PHASES):                            # not all phases up to feed passed
+        return result, PHASES[len(marks) - 1]
+
+    result["total"] = marks[-1] / 1000.0
+    return result, None
+
+
+def percentile(values, p):
+    """Nearest-rank percentile of a sorted list."""
+    if not values:
+        return float("nan")
+    rank = max(1, int(math.ceil(p / 100.0 * len(values))))
+    return values[min(rank, len(values)) - 1]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="zapping latency benchmark report")
+    parser.add_argument("capture", help="serial capture of the benchmark sketch")
+    parser.add_argument("--csv", help="write per switch phases to this file")
+    opts = parser.parse_args()
+
+    with open(opts.capture, "rb") as f:
+        data = f.read()
+
+    switches = []
+    failed = {}
+    for lost, records in parse_dumps(data):
+        result = split_switch(records)
+        if result is None:
+            continue
+        switches.append(result[0])
+        if result[1]:
+            failed[result[1]] = failed.get(result[1], 0) + 1
+
+    if not switches:
+        sys.stderr.write("no station switch found\n")
+        return 1
+
+    complete = len(switches) - sum(failed.values())
+    print("# %d station switches, %d complete, latency in msec" % (len(switches), complete))
+    if failed:
+        print("# incomplete (left out of total): " +
+              ", ".join("%s %d" % (name, failed[name]) for name in PHASES if name in failed))
+    print("%-8s %5s %8s %8s %8s %8s %8s %8s" % ("phase", "count", "min", "p50", "p90", "p99", "max", "mean"))
+    for name in PHASES:
+        values = sorted(s[name] for s in switches if name in s)
+        if not values:
+            continue
+        print("%-8s %5d %8.1f %8.1f %8.1f %8.1f %8.1f %8.1f" % (
+            name, len(values), values[0], percentile(values, 50), percentile(values, 90),
+            percentile(values, 99), values[-1], sum(values) / len(values)))
+
+    if opts.csv:
+        with open(opts.csv, "w") as f:
+            f.write(",".join(PHASES) + "\n")
+            for s in switches:
+                f.write(",".join("%.1f" % s[name] if name in s else "" for name in PHASES) + "\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())